@@ -0,0 +1,85 @@
+"""
+Effect of space-filling-curve ordering on downstream neighbour access.
+
+Points uniform in the unit ball are stored in random order. Each point has a list of neighbours
+(points of the same cell of a ~K points per cell grid). Neighbour query gathers neighbour rows,
+reduction sums dot products with them. Both are timed with random storage order and after
+`sfc_sort`, which moves rows of the batch buffer along the curve.
+
+python benchmarks/sfc.py [n_points]
+"""
+import sys
+import time
+
+import numpy as np
+
+from vector import Random, sfc_sort
+
+K = 8
+REPEAT = 5
+
+
+def timeit(f):
+    best = float('inf')
+    for _ in range(REPEAT):
+        start = time.perf_counter()
+        f()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def neighbours(pts):
+    # Grid with ~K points per cell, neighbours of a point are the next K points of its cell, cyclically
+    n = len(pts)
+    cells_per_axis = max(1, int(round((n / K) ** (1 / 3))))
+    ijk = np.clip(((pts + 1) / 2 * cells_per_axis).astype(np.int64), 0, cells_per_axis - 1)
+    cell = (ijk[:, 0] * cells_per_axis + ijk[:, 1]) * cells_per_axis + ijk[:, 2]
+    order = np.argsort(cell, kind='stable')
+    sorted_cell = cell[order]
+    starts = np.searchsorted(sorted_cell, sorted_cell, side='left')
+    counts = np.searchsorted(sorted_cell, sorted_cell, side='right') - starts
+    rank = np.arange(n) - starts
+    nbr = np.empty((n, K), dtype=np.int64)
+    for m in range(K):
+        nbr[order, m] = order[starts + (rank + m + 1) % counts]
+    return nbr
+
+
+def query(pts, nbr):
+    return pts[nbr]
+
+
+def reduction(pts, nbr):
+    return np.einsum('ij,ikj->', pts, pts[nbr])
+
+
+def main():
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 2_000_000
+    pts = np.empty((n, 3))
+    Random(0).ball(out=pts)
+    nbr = neighbours(pts)
+
+    t_query = timeit(lambda: query(pts, nbr))
+    t_reduce = timeit(lambda: reduction(pts, nbr))
+    total = reduction(pts, nbr)
+
+    for curve in ('morton', 'hilbert'):
+        sorted_pts = pts.copy()
+        start = time.perf_counter()
+        order = np.array(sfc_sort(sorted_pts, curve))
+        t_sort = time.perf_counter() - start
+        # Neighbour lists follow the points to their new positions
+        inverse = np.empty(n, dtype=np.int64)
+        inverse[order] = np.arange(n)
+        sorted_nbr = inverse[nbr[order]]
+        assert np.isclose(total, reduction(sorted_pts, sorted_nbr))
+
+        t_query_sorted = timeit(lambda: query(sorted_pts, sorted_nbr))
+        t_reduce_sorted = timeit(lambda: reduction(sorted_pts, sorted_nbr))
+        print(f'{curve:8} n={n} sort {t_sort * 1e3:8.1f} ms')
+        print(f'{"":8} query      {n * K / t_query / 1e6:8.1f} -> {n * K / t_query_sorted / 1e6:8.1f} M neighbours/s')
+        print(f'{"":8} reduction  {n * K / t_reduce / 1e6:8.1f} -> {n * K / t_reduce_sorted / 1e6:8.1f} M neighbours/s')
+
+
+if __name__ == '__main__':
+    main()
@@ -1,6 +1,15 @@
 from setuptools import setup, Extension
 
-module = Extension('vector', sources=['src/vector/src/vector.c', 'src/vector/src/utils.c'])
+module = Extension('vector', sources=[
+    'src/vector/src/vector.c',
+    'src/vector/src/utils.c',
+    'src/vector/src/rng.c',
+    'src/vector/src/random.c',
+    'src/vector/src/sfc.c',
+    'src/vector/src/batch.c',
+    'src/vector/src/zones.c',
+    'src/vector/src/crossmatch.c',
+], extra_compile_args=['-pthread'], extra_link_args=['-pthread'])
 
 setup(
     name='vector-c',
@@ -0,0 +1,277 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <limits.h>
+#include <string.h>
+#include "utils.h"
+#include "vector.h"
+#include "sfc.h"
+#include "batch.h"
+#include "crossmatch.h"
+
+int batch_open(PyObject *obj, Batch *b, int flags, const char *value_name) {
+    b->seq = NULL;
+    b->cart = NULL;
+    if (PyObject_CheckBuffer(obj)) {
+        if (get_batch(obj, &b->view, flags, value_name) != 0)
+            return -1;
+        b->is_buffer = true;
+        b->cart = b->view.buf;
+        b->n = b->view.len / (3 * sizeof(double));
+        return 0;
+    }
+    b->is_buffer = false;
+    if (!PySequence_Check(obj)) {
+        char *msg;
+        asprintf(
+                &msg,
+                "%s must be a sequence of Vectors or a buffer of doubles, got \"%s\"",
+                value_name, Py_TYPE(obj)->tp_name
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return -1;
+    }
+    b->seq = PySequence_Fast(obj, value_name);
+    if (b->seq == NULL)
+        return -1;
+    b->n = PySequence_Fast_GET_SIZE(b->seq);
+    b->cart = PyMem_RawMalloc(3 * b->n * sizeof(double) + 1);
+    if (b->cart == NULL) {
+        Py_CLEAR(b->seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    PyObject **items = PySequence_Fast_ITEMS(b->seq);
+    for (Py_ssize_t i=0; i<b->n; i++) {
+        if (!PyObject_TypeCheck(items[i], &VectorType)) {
+            char *msg;
+            asprintf(
+                    &msg,
+                    "%s must contain Vectors, got \"%s\" at %ld",
+                    value_name, Py_TYPE(items[i])->tp_name, i
+            );
+            PyErr_SetString(PyExc_TypeError, msg);
+            free(msg);
+            batch_close(b);
+            return -1;
+        }
+        memcpy(b->cart + 3*i, ((VectorObject *) items[i])->cart, 3 * sizeof(double));
+    }
+    return 0;
+}
+
+void batch_close(Batch *b) {
+    if (b->is_buffer) {
+        PyBuffer_Release(&b->view);
+    } else {
+        PyMem_RawFree(b->cart);
+        Py_CLEAR(b->seq);
+    }
+    b->cart = NULL;
+}
+
+int parse_threads(Py_ssize_t threads, const char *value_name) {
+    if (threads < 0 || threads > INT_MAX) {
+        char *msg;
+        asprintf(&msg, "%s must be within [0, %d], got %ld", value_name, INT_MAX, threads);
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        return -1;
+    }
+    // 0 stands for all available cores
+    if (threads == 0)
+        return cpu_count();
+    return (int) threads;
+}
+
+static int
+parse_curve(const char *curve, const char *coords, sfc_curve *c, sfc_coords *s) {
+    if (strcmp(curve, "morton") == 0) {
+        *c = MORTON;
+    } else if (strcmp(curve, "hilbert") == 0) {
+        *c = HILBERT;
+    } else {
+        char *msg;
+        asprintf(&msg, "curve must be \"morton\" or \"hilbert\", got \"%s\"", curve);
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        return -1;
+    }
+    if (strcmp(coords, "cart") == 0) {
+        *s = CARTESIAN;
+    } else if (strcmp(coords, "sph") == 0) {
+        *s = SPHERICAL;
+    } else {
+        char *msg;
+        asprintf(&msg, "coords must be \"cart\" or \"sph\", got \"%s\"", coords);
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+batch_sfc_keys(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"vectors", "curve", "coords", "threads", NULL};
+    PyObject *obj;
+    const char *curve_name = "hilbert";
+    const char *coords_name = "cart";
+    Py_ssize_t threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ssn", kwlist, &obj, &curve_name, &coords_name, &threads))
+        return NULL;
+    sfc_curve curve;
+    sfc_coords coords;
+    if (parse_curve(curve_name, coords_name, &curve, &coords) != 0)
+        return NULL;
+    int n_threads = parse_threads(threads, "sfc_keys threads");
+    if (n_threads < 0)
+        return NULL;
+
+    Batch b;
+    if (batch_open(obj, &b, PyBUF_SIMPLE, "sfc_keys vectors") != 0)
+        return NULL;
+    uint64_t *keys = PyMem_RawMalloc(b.n * sizeof(uint64_t) + 1);
+    if (keys == NULL) {
+        batch_close(&b);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    sfc_keys(b.cart, b.n, curve, coords, keys, n_threads);
+    Py_END_ALLOW_THREADS
+
+    PyObject *res = PyList_New(b.n);
+    for (Py_ssize_t i=0; res != NULL && i<b.n; i++) {
+        PyObject *key = PyLong_FromUnsignedLongLong(keys[i]);
+        if (key == NULL)
+            Py_CLEAR(res);
+        else
+            PyList_SET_ITEM(res, i, key);
+    }
+    PyMem_RawFree(keys);
+    batch_close(&b);
+    return res;
+}
+
+static int
+sort_by_curve(double cart[], Py_ssize_t n, sfc_curve curve, sfc_coords coords, Py_ssize_t order[], int threads) {
+    uint64_t *keys = malloc(n * sizeof(uint64_t) + 1);
+    if (keys == NULL)
+        return -1;
+    sfc_keys(cart, n, curve, coords, keys, threads);
+    for (Py_ssize_t i=0; i<n; i++)
+        order[i] = i;
+    int res = radix_sort(keys, order, n, threads);
+    free(keys);
+    return res;
+}
+
+static PyObject *
+batch_sfc_sort(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"vectors", "curve", "coords", "threads", NULL};
+    PyObject *obj;
+    const char *curve_name = "hilbert";
+    const char *coords_name = "cart";
+    Py_ssize_t threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ssn", kwlist, &obj, &curve_name, &coords_name, &threads))
+        return NULL;
+    sfc_curve curve;
+    sfc_coords coords;
+    if (parse_curve(curve_name, coords_name, &curve, &coords) != 0)
+        return NULL;
+    int n_threads = parse_threads(threads, "sfc_sort threads");
+    if (n_threads < 0)
+        return NULL;
+    if (!PyObject_CheckBuffer(obj) && !PyList_Check(obj)) {
+        char *msg;
+        asprintf(
+                &msg,
+                "sfc_sort vectors must be a list of Vectors or a writable buffer of doubles, got \"%s\"",
+                Py_TYPE(obj)->tp_name
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return NULL;
+    }
+
+    Batch b;
+    if (batch_open(obj, &b, PyBUF_WRITABLE, "sfc_sort vectors") != 0)
+        return NULL;
+    Py_ssize_t *order = PyMem_RawMalloc(b.n * sizeof(Py_ssize_t) + 1);
+    if (order == NULL) {
+        batch_close(&b);
+        return PyErr_NoMemory();
+    }
+    int res;
+    Py_BEGIN_ALLOW_THREADS
+    res = sort_by_curve(b.cart, b.n, curve, coords, order, n_threads);
+    // Buffer rows are permuted in place, gathering through a copy
+    if (res == 0 && b.is_buffer) {
+        double *sorted = malloc(3 * b.n * sizeof(double) + 1);
+        if (sorted == NULL) {
+            res = -1;
+        } else {
+            for (Py_ssize_t i=0; i<b.n; i++)
+                memcpy(sorted + 3*i, b.cart + 3 * order[i], 3 * sizeof(double));
+            memcpy(b.cart, sorted, 3 * b.n * sizeof(double));
+            free(sorted);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (res != 0) {
+        PyMem_RawFree(order);
+        batch_close(&b);
+        return PyErr_NoMemory();
+    }
+    // Other threads could have changed the list while the GIL was released
+    if (!b.is_buffer && PyList_GET_SIZE(b.seq) != b.n) {
+        PyErr_SetString(PyExc_RuntimeError, "sfc_sort vectors list changed size during sort");
+        PyMem_RawFree(order);
+        batch_close(&b);
+        return NULL;
+    }
+
+    // List items are permuted in place, references are only moved around
+    if (!b.is_buffer) {
+        PyObject **items = PySequence_Fast_ITEMS(b.seq);
+        PyObject **sorted = PyMem_RawMalloc(b.n * sizeof(PyObject *) + 1);
+        if (sorted == NULL) {
+            PyMem_RawFree(order);
+            batch_close(&b);
+            return PyErr_NoMemory();
+        }
+        for (Py_ssize_t i=0; i<b.n; i++)
+            sorted[i] = items[order[i]];
+        memcpy(items, sorted, b.n * sizeof(PyObject *));
+        PyMem_RawFree(sorted);
+    }
+
+    PyObject *perm = PyList_New(b.n);
+    for (Py_ssize_t i=0; perm != NULL && i<b.n; i++) {
+        PyObject *idx = PyLong_FromSsize_t(order[i]);
+        if (idx == NULL)
+            Py_CLEAR(perm);
+        else
+            PyList_SET_ITEM(perm, i, idx);
+    }
+    PyMem_RawFree(order);
+    batch_close(&b);
+    return perm;
+}
+
+PyMethodDef batch_methods[] = {
+    {
+        "sfc_keys", (PyCFunction) batch_sfc_keys, METH_VARARGS | METH_KEYWORDS,
+        "Morton or Hilbert curve keys of vectors, by cartesian coordinates or by direction (lat, lon)"
+    },
+    {
+        "sfc_sort", (PyCFunction) batch_sfc_sort, METH_VARARGS | METH_KEYWORDS,
+        "Reorders vectors in place along Morton or Hilbert curve, returns original index of each vector"
+    },
+    {
+        "crossmatch", (PyCFunction) crossmatch, METH_VARARGS | METH_KEYWORDS,
+        "Pairs of directions from two collections within angular radius, iterator over chunks of "
+        "(a indices, b indices, separations)"
+    },
+    {NULL}
+};
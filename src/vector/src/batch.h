@@ -0,0 +1,22 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <Python.h>
+#include "utils.h"
+
+// Collection of vectors, either a contiguous buffer of doubles (used in place),
+// or a sequence of Vectors (cartesian components copied out)
+typedef struct {
+    double *cart;
+    Py_ssize_t n;
+    bool is_buffer;
+    Py_buffer view;
+    PyObject *seq;
+} Batch;
+
+int batch_open(PyObject *, Batch *, int flags, const char *value_name);
+void batch_close(Batch *);
+int parse_threads(Py_ssize_t threads, const char *value_name);
+
+extern PyMethodDef batch_methods[];
+
+#endif
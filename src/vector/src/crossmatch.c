@@ -0,0 +1,228 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+#include <string.h>
+#include "utils.h"
+#include "batch.h"
+#include "zones.h"
+#include "crossmatch.h"
+
+// Minimal rows of a chunk per thread, fewer don't pay for the thread start up
+#define ROWS_PER_THREAD 1024
+
+// Iterator over match chunks, keeps first collection open and zone index of the second one
+typedef struct {
+    PyObject_HEAD
+    Batch a;
+    zone_index index;
+    bool nearest;
+    Py_ssize_t chunk_size;
+    int threads;
+    Py_ssize_t next;
+    bool busy;
+} CrossMatchObject;
+
+typedef struct {
+    zone_index *index;
+    double *cart;
+    Py_ssize_t start;
+    bool nearest;
+    match_list *lists;
+    bool *failed;
+} chunk_ctx;
+
+static void match_rows(void *arg, Py_ssize_t lo, Py_ssize_t hi, int t) {
+    chunk_ctx *c = arg;
+    for (Py_ssize_t i=c->start + lo; i<c->start + hi; i++) {
+        if (zone_match(c->index, c->cart + 3*i, i, c->nearest, c->lists + t) != 0) {
+            c->failed[t] = true;
+            return;
+        }
+    }
+}
+
+static PyObject *
+to_list(match_list lists[], int threads, Py_ssize_t total, int what) {
+    PyObject *res = PyList_New(total);
+    Py_ssize_t k = 0;
+    for (int t=0; res != NULL && t<threads; t++) {
+        for (Py_ssize_t i=0; i<lists[t].len; i++) {
+            PyObject *item;
+            if (what == 0)
+                item = PyLong_FromSsize_t(lists[t].a[i]);
+            else if (what == 1)
+                item = PyLong_FromSsize_t(lists[t].b[i]);
+            else
+                item = PyFloat_FromDouble(lists[t].sep[i]);
+            if (item == NULL) {
+                Py_CLEAR(res);
+                break;
+            }
+            PyList_SET_ITEM(res, k++, item);
+        }
+    }
+    return res;
+}
+
+static void
+CrossMatch_release(CrossMatchObject *self) {
+    if (self->a.cart != NULL)
+        batch_close(&self->a);
+    zone_index_free(&self->index);
+}
+
+// Matches of the next chunk of rows of the first collection: (a indices, b indices, separations).
+// Chunks without matches are skipped, pairs are ordered by the first index.
+static PyObject *
+CrossMatch_next(CrossMatchObject *self) {
+    // Exhausted, `a` and the index are already released
+    if (self->a.cart == NULL)
+        return NULL;
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "crossmatch iterator is already running in another thread");
+        return NULL;
+    }
+    int threads = self->threads;
+    match_list *lists = calloc(threads, sizeof(match_list));
+    bool *failed = calloc(threads, sizeof(bool));
+    if (lists == NULL || failed == NULL) {
+        free(lists);
+        free(failed);
+        return PyErr_NoMemory();
+    }
+
+    chunk_ctx c = {
+        .index = &self->index, .cart = self->a.cart, .nearest = self->nearest, .lists = lists, .failed = failed
+    };
+    Py_ssize_t total = 0;
+    bool oom = false;
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    while (total == 0 && !oom && self->next < self->a.n) {
+        Py_ssize_t rows = self->a.n - self->next;
+        if (rows > self->chunk_size)
+            rows = self->chunk_size;
+        c.start = self->next;
+        int chunk_threads = threads;
+        if (chunk_threads > rows / ROWS_PER_THREAD + 1)
+            chunk_threads = (int) (rows / ROWS_PER_THREAD + 1);
+        parallel_for(chunk_threads, rows, match_rows, &c);
+        self->next += rows;
+        for (int t=0; t<threads; t++) {
+            oom = oom || failed[t];
+            total += lists[t].len;
+        }
+    }
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyObject *res = NULL;
+    if (oom) {
+        PyErr_NoMemory();
+    } else if (total > 0) {
+        PyObject *a = to_list(lists, threads, total, 0);
+        PyObject *b = to_list(lists, threads, total, 1);
+        PyObject *sep = to_list(lists, threads, total, 2);
+        if (a != NULL && b != NULL && sep != NULL)
+            res = PyTuple_Pack(3, a, b, sep);
+        Py_XDECREF(a);
+        Py_XDECREF(b);
+        Py_XDECREF(sep);
+    }
+    for (int t=0; t<threads; t++)
+        match_list_free(lists + t);
+    free(lists);
+    free(failed);
+    // Last chunk is done, so a buffer passed as `a` may be resized again
+    if (self->next >= self->a.n)
+        CrossMatch_release(self);
+    // NULL without an exception set stops the iteration
+    return res;
+}
+
+static void
+CrossMatch_dealloc(CrossMatchObject *self) {
+    CrossMatch_release(self);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyObject *
+crossmatch(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"a", "b", "radius", "mode", "chunk_size", "threads", NULL};
+    PyObject *a;
+    PyObject *b;
+    double radius;
+    const char *mode = "nearest";
+    Py_ssize_t chunk_size = 1 << 16;
+    Py_ssize_t threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOd|snn", kwlist, &a, &b, &radius, &mode, &chunk_size, &threads))
+        return NULL;
+
+    bool nearest;
+    if (strcmp(mode, "nearest") == 0) {
+        nearest = true;
+    } else if (strcmp(mode, "all") == 0) {
+        nearest = false;
+    } else {
+        char *msg;
+        asprintf(&msg, "crossmatch mode must be \"nearest\" or \"all\", got \"%s\"", mode);
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        return NULL;
+    }
+    if (!(radius >= 0. && radius <= M_PI)) {
+        PyErr_SetString(PyExc_ValueError, "crossmatch radius must be within [0, pi]");
+        return NULL;
+    }
+    if (chunk_size < 1) {
+        PyErr_SetString(PyExc_ValueError, "crossmatch chunk_size must be positive");
+        return NULL;
+    }
+    int n_threads = parse_threads(threads, "crossmatch threads");
+    if (n_threads < 0)
+        return NULL;
+
+    CrossMatchObject *self = (CrossMatchObject *) CrossMatchType.tp_alloc(&CrossMatchType, 0);
+    if (self == NULL)
+        return NULL;
+    self->nearest = nearest;
+    self->chunk_size = chunk_size;
+
+    Batch bb;
+    if (batch_open(b, &bb, PyBUF_SIMPLE, "crossmatch b") != 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    int res;
+    Py_BEGIN_ALLOW_THREADS
+    res = zone_index_build(&self->index, bb.cart, bb.n, radius, n_threads);
+    Py_END_ALLOW_THREADS
+    batch_close(&bb);
+    if (res != 0) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+
+    if (batch_open(a, &self->a, PyBUF_SIMPLE, "crossmatch a") != 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    // No more threads than a chunk of rows can keep busy
+    Py_ssize_t rows = chunk_size < self->a.n ? chunk_size : self->a.n;
+    self->threads = n_threads;
+    if (self->threads > rows / ROWS_PER_THREAD + 1)
+        self->threads = (int) (rows / ROWS_PER_THREAD + 1);
+    return (PyObject *) self;
+}
+
+PyTypeObject CrossMatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "vector.CrossMatch",
+    .tp_doc = "Chunks of crossmatch pairs: (a indices, b indices, separations)",
+    .tp_basicsize = sizeof(CrossMatchObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) CrossMatch_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) CrossMatch_next,
+};
@@ -0,0 +1,9 @@
+#ifndef CROSSMATCH_H
+#define CROSSMATCH_H
+#include <Python.h>
+
+extern PyTypeObject CrossMatchType;
+
+PyObject *crossmatch(PyObject *module, PyObject *args, PyObject *kwds);
+
+#endif
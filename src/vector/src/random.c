@@ -0,0 +1,270 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+#include <time.h>
+#include "utils.h"
+#include "vector.h"
+#include "rng.h"
+#include "random.h"
+
+typedef struct {
+    PyObject_HEAD
+    rng_state state;
+    bool busy;
+} RandomObject;
+
+typedef enum { SPHERE, BALL, GAUSS, CONE } Distribution;
+
+typedef struct {
+    Distribution kind;
+    double sigma;
+    double axis[3];
+    double angle;
+} Sampler;
+
+static void
+sample(RandomObject *self, Sampler *s, double out[], Py_ssize_t n) {
+    switch (s->kind) {
+        case SPHERE:
+            rng_sphere(&self->state, out, n);
+            break;
+        case BALL:
+            rng_ball(&self->state, out, n);
+            break;
+        case GAUSS:
+            rng_gauss(&self->state, out, n, s->sigma);
+            break;
+        case CONE:
+            rng_cone(&self->state, out, n, s->axis, s->angle);
+            break;
+    }
+}
+
+// State is advanced without the GIL, so one generator can't be shared between threads
+static bool
+check_idle(RandomObject *self) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Random is already generating in another thread, use split() per thread");
+        return false;
+    }
+    return true;
+}
+
+// Either returns list of n new Vectors, or fills `out` batch buffer in place and returns it.
+// Generation itself runs without the GIL, so separate Random streams may be used from several threads.
+static PyObject *
+generate(RandomObject *self, Sampler *s, Py_ssize_t n, PyObject *out, const char *name) {
+    if (!check_idle(self))
+        return NULL;
+    if (out != NULL && out != Py_None) {
+        Py_buffer view;
+        if (get_batch(out, &view, PyBUF_WRITABLE, name) != 0)
+            return NULL;
+        Py_ssize_t rows = view.len / (3 * sizeof(double));
+        if (n >= 0 && n != rows) {
+            char *msg;
+            asprintf(
+                    &msg,
+                    "%s holds %ld vectors, but n=%ld requested",
+                    name, rows, n
+            );
+            PyErr_SetString(PyExc_ValueError, msg);
+            free(msg);
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+        self->busy = true;
+        Py_BEGIN_ALLOW_THREADS
+        sample(self, s, (double *) view.buf, rows);
+        Py_END_ALLOW_THREADS
+        self->busy = false;
+        PyBuffer_Release(&view);
+        Py_INCREF(out);
+        return out;
+    }
+
+    if (n < 0) {
+        char *msg;
+        asprintf(&msg, "%s requires either non-negative \"n\" or \"out\"", name);
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        return NULL;
+    }
+    if (n > ((Py_ssize_t) (PY_SSIZE_T_MAX / sizeof(double)) - 1) / 3)
+        return PyErr_NoMemory();
+    double *buf = PyMem_RawMalloc((3 * n + 1) * sizeof(double));
+    if (buf == NULL)
+        return PyErr_NoMemory();
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    sample(self, s, buf, n);
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyObject *list = PyList_New(n);
+    if (list == NULL) {
+        PyMem_RawFree(buf);
+        return NULL;
+    }
+    for (Py_ssize_t i=0; i<n; i++) {
+        PyObject *v = Vector_from_cart(buf + 3*i);
+        if (v == NULL) {
+            Py_DECREF(list);
+            PyMem_RawFree(buf);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, v);
+    }
+    PyMem_RawFree(buf);
+    return list;
+}
+
+static PyObject *
+Random_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    RandomObject *self;
+    self = (RandomObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        rng_seed(&self->state, (uint64_t) time(NULL) ^ (uint64_t) clock() ^ (uint64_t) (uintptr_t) self);
+    }
+    return (PyObject *) self;
+}
+
+static int
+Random_init(RandomObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"seed", "stream", NULL};
+    PyObject *seed = NULL;
+    Py_ssize_t stream = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|On", kwlist, &seed, &stream))
+        return -1;
+    if (seed != NULL && seed != Py_None) {
+        if (!PyLong_Check(seed)) {
+            char *msg;
+            asprintf(
+                    &msg,
+                    "Random seed must be an integer, got \"%s\"",
+                    Py_TYPE(seed)->tp_name
+            );
+            PyErr_SetString(PyExc_TypeError, msg);
+            free(msg);
+            return -1;
+        }
+        // Only the low 64 bits are used, negative seeds wrap around
+        uint64_t value = PyLong_AsUnsignedLongLongMask(seed);
+        if (value == (uint64_t) -1 && PyErr_Occurred())
+            return -1;
+        rng_seed(&self->state, value);
+    }
+    if (stream < 0) {
+        PyErr_SetString(PyExc_ValueError, "Random stream must be non-negative");
+        return -1;
+    }
+    rng_stream(&self->state, (uint64_t) stream);
+    return 0;
+}
+
+static PyObject *
+Random_split(RandomObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!check_idle(self))
+        return NULL;
+    RandomObject *child = (RandomObject *) Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0);
+    if (child == NULL)
+        return NULL;
+    // Child continues the current stream, parent moves 2^128 draws ahead
+    child->state = self->state;
+    rng_jump(&self->state);
+    return (PyObject *) child;
+}
+
+static PyObject *
+Random_uniform(RandomObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!check_idle(self))
+        return NULL;
+    return Py_BuildValue("d", rng_uniform(&self->state));
+}
+
+static PyObject *
+Random_sphere(RandomObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"n", "out", NULL};
+    Py_ssize_t n = -1;
+    PyObject *out = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nO", kwlist, &n, &out))
+        return NULL;
+    Sampler s = {.kind = SPHERE};
+    return generate(self, &s, n, out, "Random.sphere output");
+}
+
+static PyObject *
+Random_ball(RandomObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"n", "out", NULL};
+    Py_ssize_t n = -1;
+    PyObject *out = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nO", kwlist, &n, &out))
+        return NULL;
+    Sampler s = {.kind = BALL};
+    return generate(self, &s, n, out, "Random.ball output");
+}
+
+static PyObject *
+Random_gauss(RandomObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"n", "sigma", "out", NULL};
+    Py_ssize_t n = -1;
+    double sigma = 1.;
+    PyObject *out = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ndO", kwlist, &n, &sigma, &out))
+        return NULL;
+    Sampler s = {.kind = GAUSS, .sigma = sigma};
+    return generate(self, &s, n, out, "Random.gauss output");
+}
+
+static PyObject *
+Random_cone(RandomObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"axis", "angle", "n", "out", NULL};
+    PyObject *axis = NULL;
+    double angle;
+    Py_ssize_t n = -1;
+    PyObject *out = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Od|nO", kwlist, &axis, &angle, &n, &out))
+        return NULL;
+
+    Sampler s = {.kind = CONE, .angle = angle};
+    if (PyObject_TypeCheck(axis, &VectorType)) {
+        for (int i=0; i<3; i++)
+            s.axis[i] = ((VectorObject *) axis)->cart[i];
+    } else if (check_array(axis, s.axis, "Random.cone axis") != 0) {
+        return NULL;
+    }
+    double r = r_from_cartesian(s.axis);
+    if (r == 0. || isnan(r)) {
+        PyErr_SetString(PyExc_ValueError, "Random.cone axis must be a non-zero vector");
+        return NULL;
+    }
+    for (int i=0; i<3; i++)
+        s.axis[i] /= r;
+    if (!(angle >= 0. && angle <= M_PI)) {
+        PyErr_SetString(PyExc_ValueError, "Random.cone angle must be within [0, pi]");
+        return NULL;
+    }
+    return generate(self, &s, n, out, "Random.cone output");
+}
+
+static PyMethodDef Random_methods[] = {
+    {"split", (PyCFunction) Random_split, METH_NOARGS, "New generator on an independent stream"},
+    {"uniform", (PyCFunction) Random_uniform, METH_NOARGS, "Uniform float in [0, 1)"},
+    {"sphere", (PyCFunction) Random_sphere, METH_VARARGS | METH_KEYWORDS, "Uniform on the unit sphere"},
+    {"ball", (PyCFunction) Random_ball, METH_VARARGS | METH_KEYWORDS, "Uniform in the unit ball"},
+    {"gauss", (PyCFunction) Random_gauss, METH_VARARGS | METH_KEYWORDS, "Isotropic gaussian"},
+    {"cone", (PyCFunction) Random_cone, METH_VARARGS | METH_KEYWORDS, "Uniform on the unit sphere within angle from axis"},
+    {NULL}
+};
+
+PyTypeObject RandomType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "vector.Random",
+    .tp_doc = "Random vectors generator (xoshiro256**)",
+    .tp_basicsize = sizeof(RandomObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_init = (initproc) Random_init,
+    .tp_new = Random_new,
+    .tp_methods = Random_methods,
+};
@@ -0,0 +1,7 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+#include <Python.h>
+
+extern PyTypeObject RandomType;
+
+#endif
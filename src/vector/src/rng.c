@@ -0,0 +1,158 @@
+#include "rng.h"
+#include <math.h>
+
+// xoshiro256** by D. Blackman and S. Vigna, seeded with splitmix64 as recommended by the authors
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(rng_state *st, uint64_t seed) {
+    for (int i=0; i<4; i++)
+        st->s[i] = splitmix64(&seed);
+    st->has_spare = false;
+}
+
+// Selects stream of the seeded state in O(1), re-seeding splitmix64 from the state mixed with the stream number.
+// Streams are only statistically independent, unlike rng_jump ones, which are provably disjoint.
+void rng_stream(rng_state *st, uint64_t stream) {
+    if (stream == 0)
+        return;
+    uint64_t x = st->s[0] ^ (stream * 0xd1342543de82ef95);
+    for (int i=0; i<4; i++)
+        st->s[i] = splitmix64(&x);
+    st->has_spare = false;
+}
+
+uint64_t rng_next(rng_state *st) {
+    uint64_t *s = st->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// Equivalent to 2^128 calls of rng_next, gives non-overlapping streams from the same seed
+void rng_jump(rng_state *st) {
+    static const uint64_t JUMP[] = {
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+    };
+    uint64_t s[4] = {0, 0, 0, 0};
+    for (int i=0; i<4; i++) {
+        for (int b=0; b<64; b++) {
+            if (JUMP[i] & ((uint64_t) 1 << b)) {
+                for (int k=0; k<4; k++)
+                    s[k] ^= st->s[k];
+            }
+            rng_next(st);
+        }
+    }
+    for (int k=0; k<4; k++)
+        st->s[k] = s[k];
+    st->has_spare = false;
+}
+
+// Uniform in [0, 1), 53 random bits
+double rng_uniform(rng_state *st) {
+    return (rng_next(st) >> 11) * 0x1.0p-53;
+}
+
+// Standard normal deviate, Marsaglia polar method
+double rng_normal(rng_state *st) {
+    if (st->has_spare) {
+        st->has_spare = false;
+        return st->spare;
+    }
+    double u, v, s;
+    do {
+        u = 2. * rng_uniform(st) - 1.;
+        v = 2. * rng_uniform(st) - 1.;
+        s = u*u + v*v;
+    } while (s >= 1. || s == 0.);
+    s = sqrt(-2. * log(s) / s);
+    st->spare = v * s;
+    st->has_spare = true;
+    return u * s;
+}
+
+// Uniform on the unit sphere, Marsaglia (1972): no trigonometry, ~1.27 pairs per point
+void rng_sphere(rng_state *st, double out[], Py_ssize_t n) {
+    for (Py_ssize_t i=0; i<n; i++) {
+        double u, v, s;
+        do {
+            u = 2. * rng_uniform(st) - 1.;
+            v = 2. * rng_uniform(st) - 1.;
+            s = u*u + v*v;
+        } while (s >= 1.);
+        double f = 2. * sqrt(1. - s);
+        out[3*i] = u * f;
+        out[3*i + 1] = v * f;
+        out[3*i + 2] = 1. - 2. * s;
+    }
+}
+
+// Uniform in the unit ball: direction on the sphere, radius distributed as cbrt(U)
+void rng_ball(rng_state *st, double out[], Py_ssize_t n) {
+    rng_sphere(st, out, n);
+    for (Py_ssize_t i=0; i<n; i++) {
+        double r = cbrt(rng_uniform(st));
+        out[3*i] *= r;
+        out[3*i + 1] *= r;
+        out[3*i + 2] *= r;
+    }
+}
+
+// Isotropic gaussian with the same sigma along every axis
+void rng_gauss(rng_state *st, double out[], Py_ssize_t n, double sigma) {
+    for (Py_ssize_t i=0; i<3*n; i++)
+        out[i] = sigma * rng_normal(st);
+}
+
+// Uniform on the part of the unit sphere within `angle` from `axis`, axis must be normalized
+void rng_cone(rng_state *st, double out[], Py_ssize_t n, double axis[], double angle) {
+    // Orthonormal basis (e1, e2, axis), e1 built from the coordinate axis least aligned with `axis`
+    double tmp[3] = {0, 0, 0};
+    if (fabs(axis[0]) < 0.9)
+        tmp[0] = 1;
+    else
+        tmp[1] = 1;
+    double e1[3] = {
+        tmp[1] * axis[2] - tmp[2] * axis[1],
+        tmp[2] * axis[0] - tmp[0] * axis[2],
+        tmp[0] * axis[1] - tmp[1] * axis[0]
+    };
+    double norm = r_from_cartesian(e1);
+    for (int k=0; k<3; k++)
+        e1[k] /= norm;
+    double e2[3] = {
+        axis[1] * e1[2] - axis[2] * e1[1],
+        axis[2] * e1[0] - axis[0] * e1[2],
+        axis[0] * e1[1] - axis[1] * e1[0]
+    };
+
+    // Area is uniform in cos(theta), so cos(theta) is uniform in [cos(angle), 1]
+    double one_minus_cos = 1. - cos(angle);
+    for (Py_ssize_t i=0; i<n; i++) {
+        double cos_t = 1. - rng_uniform(st) * one_minus_cos;
+        double sin_t = sqrt(fmax(0., 1. - cos_t*cos_t));
+        double phi = 2. * M_PI * rng_uniform(st);
+        double a = sin_t * cos(phi);
+        double b = sin_t * sin(phi);
+        for (int k=0; k<3; k++)
+            out[3*i + k] = a * e1[k] + b * e2[k] + cos_t * axis[k];
+    }
+}
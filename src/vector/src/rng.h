@@ -0,0 +1,26 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+#include "utils.h"
+
+// xoshiro256** generator state, together with the spare normal deviate of the polar method
+typedef struct {
+    uint64_t s[4];
+    double spare;
+    bool has_spare;
+} rng_state;
+
+void rng_seed(rng_state *, uint64_t seed);
+void rng_stream(rng_state *, uint64_t stream);
+void rng_jump(rng_state *);
+uint64_t rng_next(rng_state *);
+double rng_uniform(rng_state *);
+double rng_normal(rng_state *);
+
+// Samplers fill `out` with n vectors, stored as 3 * n consecutive cartesian components
+void rng_sphere(rng_state *, double out[], Py_ssize_t n);
+void rng_ball(rng_state *, double out[], Py_ssize_t n);
+void rng_gauss(rng_state *, double out[], Py_ssize_t n, double sigma);
+void rng_cone(rng_state *, double out[], Py_ssize_t n, double axis[], double angle);
+
+#endif
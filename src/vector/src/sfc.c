@@ -0,0 +1,267 @@
+#include "sfc.h"
+#include <math.h>
+#include <string.h>
+
+#define CART_BITS 21
+#define SPH_BITS 32
+// Below this size thread start up costs more than the work itself
+#define RADIX_PARALLEL_MIN (1 << 16)
+
+// Spreads the lower 32 bits of x to the even bits of the result
+static uint64_t spread_2(uint64_t x) {
+    x &= 0xffffffff;
+    x = (x | (x << 16)) & 0x0000ffff0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0f;
+    x = (x | (x << 2)) & 0x3333333333333333;
+    x = (x | (x << 1)) & 0x5555555555555555;
+    return x;
+}
+
+// Spreads the lower 21 bits of x to every third bit of the result
+static uint64_t spread_3(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | (x << 32)) & 0x001f00000000ffff;
+    x = (x | (x << 16)) & 0x001f0000ff0000ff;
+    x = (x | (x << 8)) & 0x100f00f00f00f00f;
+    x = (x | (x << 4)) & 0x10c30c30c30c30c3;
+    x = (x | (x << 2)) & 0x1249249249249249;
+    return x;
+}
+
+uint64_t morton_2(uint32_t x, uint32_t y) {
+    return (spread_2(x) << 1) | spread_2(y);
+}
+
+uint64_t morton_3(uint32_t x, uint32_t y, uint32_t z) {
+    return (spread_3(x) << 2) | (spread_3(y) << 1) | spread_3(z);
+}
+
+// J. Skilling, "Programming the Hilbert curve" (2004): coordinates to the transposed Hilbert index
+static uint64_t hilbert(uint32_t X[], int dims, int bits) {
+    uint32_t M = (uint32_t) 1 << (bits - 1);
+    uint32_t t;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        uint32_t P = Q - 1;
+        for (int i=0; i<dims; i++) {
+            if (X[i] & Q) {
+                X[0] ^= P;
+            } else {
+                t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+    // Gray encode
+    for (int i=1; i<dims; i++)
+        X[i] ^= X[i - 1];
+    t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        if (X[dims - 1] & Q)
+            t ^= Q - 1;
+    }
+    for (int i=0; i<dims; i++)
+        X[i] ^= t;
+
+    // Interleave transposed index, most significant bits first
+    uint64_t key = 0;
+    for (int b=bits - 1; b>=0; b--) {
+        for (int i=0; i<dims; i++)
+            key = (key << 1) | ((X[i] >> b) & 1);
+    }
+    return key;
+}
+
+uint64_t hilbert_2(uint32_t x, uint32_t y) {
+    uint32_t X[2] = {x, y};
+    return hilbert(X, 2, SPH_BITS);
+}
+
+uint64_t hilbert_3(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t X[3] = {x, y, z};
+    return hilbert(X, 3, CART_BITS);
+}
+
+// At least RADIX_PARALLEL_MIN items per thread
+static int limit_threads(int threads, Py_ssize_t n) {
+    Py_ssize_t max = n / RADIX_PARALLEL_MIN;
+    if (threads > max)
+        threads = (int) max;
+    return threads < 1 ? 1 : threads;
+}
+
+static uint32_t quantize(double val, double lo, double scale, int bits) {
+    double q = (val - lo) * scale;
+    double max = (double) (((uint64_t) 1 << bits) - 1);
+    if (!(q > 0.))
+        return 0;
+    if (q > max)
+        return (uint32_t) max;
+    return (uint32_t) q;
+}
+
+typedef struct {
+    double *cart;
+    uint64_t *keys;
+    sfc_curve curve;
+    sfc_coords coords;
+    double lo[3];
+    double scale;
+    double (*bounds)[6];
+} keys_ctx;
+
+static void bounds_chunk(void *arg, Py_ssize_t lo, Py_ssize_t hi, int t) {
+    keys_ctx *c = arg;
+    double *b = c->bounds[t];
+    for (int k=0; k<3; k++) {
+        b[k] = INFINITY;
+        b[k + 3] = -INFINITY;
+    }
+    // Only finite coordinates define the cube, infinite ones are clamped to its faces, NaN to the lower one
+    for (Py_ssize_t i=lo; i<hi; i++) {
+        for (int k=0; k<3; k++) {
+            double x = c->cart[3*i + k];
+            if (!isfinite(x))
+                continue;
+            b[k] = fmin(b[k], x);
+            b[k + 3] = fmax(b[k + 3], x);
+        }
+    }
+}
+
+static void keys_chunk(void *arg, Py_ssize_t lo, Py_ssize_t hi, int t) {
+    keys_ctx *c = arg;
+    for (Py_ssize_t i=lo; i<hi; i++) {
+        double *v = c->cart + 3*i;
+        if (c->coords == CARTESIAN) {
+            uint32_t x = quantize(v[0], c->lo[0], c->scale, CART_BITS);
+            uint32_t y = quantize(v[1], c->lo[1], c->scale, CART_BITS);
+            uint32_t z = quantize(v[2], c->lo[2], c->scale, CART_BITS);
+            c->keys[i] = c->curve == HILBERT ? hilbert_3(x, y, z) : morton_3(x, y, z);
+        } else {
+            double r = r_from_cartesian(v);
+            double scale = (double) ((uint64_t) 1 << SPH_BITS) / M_PI;
+            uint32_t lon = quantize(lon_from_cartesian(v), -M_PI, scale / 2, SPH_BITS);
+            uint32_t lat = quantize(lat_from_cartesian(v, r), -M_PI / 2, scale, SPH_BITS);
+            c->keys[i] = c->curve == HILBERT ? hilbert_2(lon, lat) : morton_2(lon, lat);
+        }
+    }
+}
+
+void sfc_keys(double cart[], Py_ssize_t n, sfc_curve curve, sfc_coords coords, uint64_t keys[], int threads) {
+    threads = limit_threads(threads, n);
+    keys_ctx c = {.cart = cart, .keys = keys, .curve = curve, .coords = coords, .scale = 0.};
+    if (coords == CARTESIAN) {
+        // Isotropic quantization within the bounding cube, keeps curve locality the same along every axis
+        double single[1][6];
+        double (*bounds)[6] = threads > 1 ? malloc(threads * sizeof(*bounds)) : NULL;
+        if (bounds == NULL) {
+            bounds = single;
+            threads = 1;
+        }
+        c.bounds = bounds;
+        parallel_for(threads, n, bounds_chunk, &c);
+        double extent = 0.;
+        for (int k=0; k<3; k++) {
+            double lo = INFINITY, hi = -INFINITY;
+            for (int t=0; t<threads; t++) {
+                lo = fmin(lo, bounds[t][k]);
+                hi = fmax(hi, bounds[t][k + 3]);
+            }
+            if (lo > hi)
+                lo = hi = 0.;
+            c.lo[k] = lo;
+            extent = fmax(extent, hi - lo);
+        }
+        if (extent > 0. && isfinite(extent))
+            c.scale = (double) ((uint64_t) 1 << CART_BITS) / extent;
+        if (bounds != single)
+            free(bounds);
+    }
+    parallel_for(threads, n, keys_chunk, &c);
+}
+
+typedef struct {
+    uint64_t *keys;
+    uint64_t *keys_tmp;
+    Py_ssize_t *idx;
+    Py_ssize_t *idx_tmp;
+    Py_ssize_t (*hist)[256];
+    int shift;
+} radix_ctx;
+
+static void radix_count(void *arg, Py_ssize_t lo, Py_ssize_t hi, int t) {
+    radix_ctx *c = arg;
+    Py_ssize_t *h = c->hist[t];
+    memset(h, 0, 256 * sizeof(Py_ssize_t));
+    for (Py_ssize_t i=lo; i<hi; i++)
+        h[(c->keys[i] >> c->shift) & 0xff]++;
+}
+
+static void radix_scatter(void *arg, Py_ssize_t lo, Py_ssize_t hi, int t) {
+    radix_ctx *c = arg;
+    Py_ssize_t *h = c->hist[t];
+    for (Py_ssize_t i=lo; i<hi; i++) {
+        Py_ssize_t pos = h[(c->keys[i] >> c->shift) & 0xff]++;
+        c->keys_tmp[pos] = c->keys[i];
+        c->idx_tmp[pos] = c->idx[i];
+    }
+}
+
+int radix_sort(uint64_t keys[], Py_ssize_t idx[], Py_ssize_t n, int threads) {
+    threads = limit_threads(threads, n);
+
+    radix_ctx c = {.keys = keys, .idx = idx};
+    c.keys_tmp = malloc(n * sizeof(uint64_t) + 1);
+    c.idx_tmp = malloc(n * sizeof(Py_ssize_t) + 1);
+    c.hist = malloc(threads * sizeof(*c.hist));
+    if (c.keys_tmp == NULL || c.idx_tmp == NULL || c.hist == NULL) {
+        free(c.keys_tmp);
+        free(c.idx_tmp);
+        free(c.hist);
+        return -1;
+    }
+
+    for (c.shift=0; c.shift<64; c.shift+=8) {
+        parallel_for(threads, n, radix_count, &c);
+
+        // Per thread histograms become per thread output offsets, digit major to keep the sort stable
+        Py_ssize_t offset = 0;
+        bool trivial = false;
+        for (int d=0; d<256; d++) {
+            Py_ssize_t total = 0;
+            for (int t=0; t<threads; t++) {
+                Py_ssize_t count = c.hist[t][d];
+                c.hist[t][d] = offset + total;
+                total += count;
+            }
+            if (total == n)
+                trivial = true;
+            offset += total;
+        }
+        // All keys share this digit, nothing to move
+        if (trivial)
+            continue;
+
+        parallel_for(threads, n, radix_scatter, &c);
+        uint64_t *keys_swap = c.keys;
+        c.keys = c.keys_tmp;
+        c.keys_tmp = keys_swap;
+        Py_ssize_t *idx_swap = c.idx;
+        c.idx = c.idx_tmp;
+        c.idx_tmp = idx_swap;
+    }
+
+    // After an odd number of passes the result is in the temporary buffers
+    if (c.keys != keys) {
+        memcpy(keys, c.keys, n * sizeof(uint64_t));
+        memcpy(idx, c.idx, n * sizeof(Py_ssize_t));
+        c.keys_tmp = c.keys;
+        c.idx_tmp = c.idx;
+    }
+    free(c.keys_tmp);
+    free(c.idx_tmp);
+    free(c.hist);
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef SFC_H
+#define SFC_H
+#include <stdint.h>
+#include "utils.h"
+
+typedef enum { MORTON, HILBERT } sfc_curve;
+typedef enum { CARTESIAN, SPHERICAL } sfc_coords;
+
+uint64_t morton_2(uint32_t x, uint32_t y);
+uint64_t morton_3(uint32_t x, uint32_t y, uint32_t z);
+uint64_t hilbert_2(uint32_t x, uint32_t y);
+uint64_t hilbert_3(uint32_t x, uint32_t y, uint32_t z);
+
+// Curve keys for n vectors stored as 3 * n cartesian components.
+// CARTESIAN quantizes points within their bounding cube to 21 bits per axis,
+// SPHERICAL quantizes directions (lon, lat) to 32 bits per angle.
+void sfc_keys(double cart[], Py_ssize_t n, sfc_curve, sfc_coords, uint64_t keys[], int threads);
+
+// Stable LSD radix sort of keys, idx is permuted along. Returns -1 if out of memory.
+int radix_sort(uint64_t keys[], Py_ssize_t idx[], Py_ssize_t n, int threads);
+
+#endif
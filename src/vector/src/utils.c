@@ -1,5 +1,7 @@
 #include "utils.h"
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 // DOESN'T WORK WITH __FASTMATH__ !!!
 bool isnan(double val) {
@@ -135,6 +137,103 @@ bool is_subclass(PyObject *query, PyTypeObject *cls, const char *operand) {
     return true;
 };
 
+// Batch storage is a contiguous buffer of doubles, holding 3 cartesian components per vector
+int get_batch(PyObject *obj, Py_buffer *view, int flags, const char *value_name) {
+    if (!PyObject_CheckBuffer(obj) || PyObject_GetBuffer(obj, view, flags | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        PyErr_Clear();
+        char *msg;
+        asprintf(
+                &msg,
+                "%s must be a contiguous%s buffer of doubles, got \"%s\"",
+                value_name, flags & PyBUF_WRITABLE ? " writable" : "", Py_TYPE(obj)->tp_name
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return -1;
+    }
+    if (view->itemsize != sizeof(double) || view->format == NULL || strcmp(view->format, "d") != 0) {
+        char *msg;
+        asprintf(
+                &msg,
+                "%s must be a buffer of doubles, got format \"%s\"",
+                value_name, view->format == NULL ? "B" : view->format
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    if (view->len % (3 * sizeof(double)) != 0) {
+        char *msg;
+        asprintf(
+                &msg,
+                "%s must contain a multiple of 3 elements, got %ld",
+                value_name, view->len / sizeof(double)
+        );
+        PyErr_SetString(PyExc_ValueError, msg);
+        free(msg);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+typedef struct {
+    void (*fn)(void *, Py_ssize_t, Py_ssize_t, int);
+    void *ctx;
+    Py_ssize_t lo;
+    Py_ssize_t hi;
+    int t;
+} parallel_task;
+
+static void *parallel_worker(void *arg) {
+    parallel_task *task = arg;
+    task->fn(task->ctx, task->lo, task->hi, task->t);
+    return NULL;
+}
+
+void parallel_for(int threads, Py_ssize_t n, void (*fn)(void *, Py_ssize_t, Py_ssize_t, int), void *ctx) {
+    if (threads > n)
+        threads = n > 0 ? (int) n : 1;
+    if (threads <= 1) {
+        fn(ctx, 0, n, 0);
+        return;
+    }
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    parallel_task *tasks = malloc(threads * sizeof(parallel_task));
+    bool *started = malloc(threads * sizeof(bool));
+    if (ids == NULL || tasks == NULL || started == NULL) {
+        // Same chunks one after another, callers may rely on the chunk numbering
+        for (int t=0; t<threads; t++)
+            fn(ctx, n * t / threads, n * (t + 1) / threads, t);
+        free(ids);
+        free(tasks);
+        free(started);
+        return;
+    }
+    for (int t=0; t<threads; t++) {
+        tasks[t] = (parallel_task) {fn, ctx, n * t / threads, n * (t + 1) / threads, t};
+        started[t] = t > 0 && pthread_create(ids + t, NULL, parallel_worker, tasks + t) == 0;
+    }
+    // Chunk 0 and chunks of the threads failed to start are done by the calling thread
+    for (int t=0; t<threads; t++) {
+        if (!started[t])
+            parallel_worker(tasks + t);
+    }
+    for (int t=1; t<threads; t++) {
+        if (started[t])
+            pthread_join(ids[t], NULL);
+    }
+    free(ids);
+    free(tasks);
+    free(started);
+}
+
 void spherical_to_cartesian_3(double sph[], double cart[]) {
     double r = sph[0];
     double lat = sph[1];
@@ -12,6 +12,11 @@ bool arr_cmp(double [], double[], Py_ssize_t);
 bool check_float(PyObject *, double *);
 int check_array(PyObject *arr, double target[], const char *value_name);
 bool is_subclass(PyObject *, PyTypeObject *, const char *);
+int get_batch(PyObject *, Py_buffer *, int flags, const char *value_name);
+
+int cpu_count(void);
+// Runs fn over [0, n) split into contiguous chunks, one per thread, `t` is the chunk number
+void parallel_for(int threads, Py_ssize_t n, void (*fn)(void *ctx, Py_ssize_t lo, Py_ssize_t hi, int t), void *ctx);
 
 void spherical_to_cartesian_3(double sph[], double cart[]);
 
@@ -4,13 +4,10 @@
 #include <stdio.h>
 #include "structmember.h"
 #include "utils.h"
-
-typedef struct {
-    PyObject_HEAD
-    double cart[3];
-    double sph[3];
-} VectorObject;
-static PyTypeObject VectorType;
+#include "vector.h"
+#include "random.h"
+#include "batch.h"
+#include "crossmatch.h"
 
 void clear_arr(double arr[], int n) {
     for (int i=0; i<n; i++)
@@ -34,6 +31,17 @@ Vector_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
     return (PyObject *) self;
 }
 
+// Builds Vector without going through the constructor arguments parsing, for the batch producers
+PyObject *
+Vector_from_cart(double cart[]) {
+    VectorObject *self = (VectorObject *) Vector_new(&VectorType, NULL, NULL);
+    if (self != NULL) {
+        for (int i=0; i<3; i++)
+            self->cart[i] = cart[i];
+    }
+    return (PyObject *) self;
+}
+
 static int
 Vector_init(VectorObject *self, PyObject *args, PyObject *kwds) {
     PyObject* cart = NULL;
@@ -392,12 +400,161 @@ Vector_dot(VectorObject *self, PyObject *args) {
     return Py_BuildValue("d", res);
 }
 
+// In place -----------------------------------------------------------------------------------------------------------
+static PyObject *
+Vector_iadd(PyObject *self, PyObject *other) {
+    if (!is_subclass(other, &VectorType, "+="))
+        return NULL;
+
+    for (int i=0; i<3; i++)
+        ((VectorObject *)self)->cart[i] += ((VectorObject *)other)->cart[i];
+    clear_arr(((VectorObject *)self)->sph, 3);
+
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *
+Vector_isub(PyObject *self, PyObject *other) {
+    if (!is_subclass(other, &VectorType, "-="))
+        return NULL;
+
+    for (int i=0; i<3; i++)
+        ((VectorObject *)self)->cart[i] -= ((VectorObject *)other)->cart[i];
+    clear_arr(((VectorObject *)self)->sph, 3);
+
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *
+Vector_imul(PyObject *self, PyObject *other) {
+    double *cart = ((VectorObject *)self)->cart;
+    double *sph = ((VectorObject *)self)->sph;
+    double d;
+    if (check_float(other, &d)) {
+        for (int i=0; i<3; i++)
+            cart[i] *= d;
+        // Scaling keeps direction, only R changes, negative scale flips it to the opposite one.
+        // Flipped lon is recomputed, shifting it by pi disagrees with atan2 on signed zeros.
+        if (d > 0) {
+            sph[0] *= d;
+        } else if (d < 0) {
+            sph[0] *= -d;
+            sph[1] = -sph[1];
+            if (!isnan(sph[2]))
+                sph[2] = lon_from_cartesian(cart);
+        } else {
+            clear_arr(sph, 3);
+        }
+    } else if (is_subclass(other, &VectorType, "*=")) {
+        double *b = ((VectorObject *)other)->cart;
+        double a[3] = {cart[0], cart[1], cart[2]};
+        cart[0] = a[1] * b[2] - a[2] * b[1];
+        cart[1] = a[2] * b[0] - a[0] * b[2];
+        cart[2] = a[0] * b[1] - a[1] * b[0];
+        clear_arr(sph, 3);
+    } else {
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    return self;
+}
+
+// METH_FASTCALL, so that the update does not allocate arguments tuple
+static PyObject *
+Vector_iadd_scaled(VectorObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    double k;
+    if (nargs != 2) {
+        char *msg;
+        asprintf(&msg, "Vector.iadd_scaled takes 2 arguments, got %ld", nargs);
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return NULL;
+    }
+    if (!is_subclass(args[0], &VectorType, "iadd_scaled"))
+        return NULL;
+    if (!check_float(args[1], &k)) {
+        char *msg;
+        asprintf(
+                &msg,
+                "Vector.iadd_scaled factor must be numeric, got \"%s\"",
+                Py_TYPE(args[1])->tp_name
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return NULL;
+    }
+
+    for (int i=0; i<3; i++)
+        self->cart[i] += k * ((VectorObject *) args[0])->cart[i];
+    clear_arr(self->sph, 3);
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *
+Vector_normalize_(VectorObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (isnan(self->sph[0]))
+        self->sph[0] = r_from_cartesian(self->cart);
+    double r = self->sph[0];
+    if (r == 0) {
+        PyErr_SetString(PyExc_ValueError, "Vector.normalize_ zero length Vector");
+        return NULL;
+    }
+
+    for (int i=0; i<3; i++)
+        self->cart[i] /= r;
+    // Direction is the same, lat and lon stay cached
+    self->sph[0] = 1;
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *
+Vector_set_cart_xyz(VectorObject *self, PyObject *const *args, Py_ssize_t nargs) {
+    double cart[3];
+    if (nargs != 3) {
+        char *msg;
+        asprintf(&msg, "Vector.set_cart_xyz takes 3 arguments, got %ld", nargs);
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return NULL;
+    }
+    for (int i=0; i<3; i++) {
+        if (check_float(args[i], cart + i))
+            continue;
+        char *msg;
+        asprintf(
+                &msg,
+                "Vector.set_cart_xyz arguments must be numeric, got \"%s\" at %i",
+                Py_TYPE(args[i])->tp_name, i
+        );
+        PyErr_SetString(PyExc_TypeError, msg);
+        free(msg);
+        return NULL;
+    }
+
+    for (int i=0; i<3; i++)
+        self->cart[i] = cart[i];
+    clear_arr(self->sph, 3);
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
 static PyNumberMethods Vector_as_number = {
     .nb_add = Vector_add,
     .nb_subtract = Vector_sub,
     .nb_multiply = Vector_mul,
     .nb_negative = (unaryfunc) Vector_neg,
     .nb_absolute = (unaryfunc) Vector_abs,
+    .nb_inplace_add = Vector_iadd,
+    .nb_inplace_subtract = Vector_isub,
+    .nb_inplace_multiply = Vector_imul,
 };
 
 static PyGetSetDef Vector_get_sets[] = {
@@ -500,12 +657,15 @@ Vector___setstate__(VectorObject *self, PyObject *state) {
 
 static PyMethodDef Vector_methods[] = {
     {"dot", (PyCFunction) Vector_dot, METH_VARARGS, "Vectors dot product"},
+    {"iadd_scaled", (PyCFunction)(void(*)(void)) Vector_iadd_scaled, METH_FASTCALL, "In place self += k * other"},
+    {"normalize_", (PyCFunction) Vector_normalize_, METH_NOARGS, "In place scale to unit length"},
+    {"set_cart_xyz", (PyCFunction)(void(*)(void)) Vector_set_cart_xyz, METH_FASTCALL, "In place set cartesian components"},
     {"__getstate__", (PyCFunction) Vector___getstate__, METH_NOARGS, "Pickle"},
     {"__setstate__", (PyCFunction) Vector___setstate__, METH_O, "UnPickle"},
     {NULL}
 };
 
-static PyTypeObject VectorType = {
+PyTypeObject VectorType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     .tp_name = "vector.Vector",
     .tp_doc = "Vector object",
@@ -529,6 +689,7 @@ static PyModuleDef vectormodule = {
     .m_name = "vector",
     .m_doc = "Vector algebra module.",
     .m_size = -1,
+    .m_methods = batch_methods,
 };
 
 PyMODINIT_FUNC
@@ -536,6 +697,10 @@ PyInit_vector(void) {
     PyObject *m;
     if (PyType_Ready(&VectorType) < 0)
         return NULL;
+    if (PyType_Ready(&RandomType) < 0)
+        return NULL;
+    if (PyType_Ready(&CrossMatchType) < 0)
+        return NULL;
 
     m = PyModule_Create(&vectormodule);
     if (m == NULL)
@@ -548,6 +713,13 @@ PyInit_vector(void) {
         return NULL;
     }
 
+    Py_INCREF(&RandomType);
+    if (PyModule_AddObject(m, "Random", (PyObject *) &RandomType) < 0) {
+        Py_DECREF(&RandomType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
     return m;
 }
 
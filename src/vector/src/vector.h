@@ -0,0 +1,14 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+#include <Python.h>
+
+typedef struct {
+    PyObject_HEAD
+    double cart[3];
+    double sph[3];
+} VectorObject;
+extern PyTypeObject VectorType;
+
+PyObject *Vector_from_cart(double cart[]);
+
+#endif
@@ -0,0 +1,227 @@
+#include "zones.h"
+#include <math.h>
+#include <string.h>
+#include "sfc.h"
+
+#define MAX_ZONES (1 << 20)
+#define RA_BITS 40
+// Guards ra windows and zone bounds against rounding, exact distance is checked for every candidate anyway
+#define PAD 1e-9
+
+static bool normalize(double v[], double out[]) {
+    double r = r_from_cartesian(v);
+    if (!(r > 0.) || !isfinite(r))
+        return false;
+    for (int k=0; k<3; k++)
+        out[k] = v[k] / r;
+    return true;
+}
+
+static int zone_of(zone_index *z, double dec) {
+    int zone = (int) floor((dec + M_PI / 2) / z->height);
+    if (zone < 0)
+        return 0;
+    if (zone >= z->n_zones)
+        return z->n_zones - 1;
+    return zone;
+}
+
+int zone_index_build(zone_index *z, double cart[], Py_ssize_t n, double radius, int threads) {
+    memset(z, 0, sizeof(zone_index));
+    z->radius = radius;
+    z->chord2 = 4. * sin(radius / 2) * sin(radius / 2);
+    z->height = fmax(radius, M_PI / MAX_ZONES);
+    z->n_zones = (int) fmin(ceil(M_PI / z->height), MAX_ZONES);
+    if (z->n_zones < 1)
+        z->n_zones = 1;
+
+    int res = -1;
+    double *unit = malloc(3 * n * sizeof(double) + 1);
+    Py_ssize_t *src = malloc(n * sizeof(Py_ssize_t) + 1);
+    uint64_t *keys = malloc(n * sizeof(uint64_t) + 1);
+    Py_ssize_t *order = malloc(n * sizeof(Py_ssize_t) + 1);
+    z->cart = malloc(3 * n * sizeof(double) + 1);
+    z->ra = malloc(n * sizeof(double) + 1);
+    z->idx = malloc(n * sizeof(Py_ssize_t) + 1);
+    z->zone_start = calloc(z->n_zones + 1, sizeof(Py_ssize_t));
+    if (unit == NULL || src == NULL || keys == NULL || order == NULL ||
+        z->cart == NULL || z->ra == NULL || z->idx == NULL || z->zone_start == NULL)
+        goto done;
+
+    // Sort key is zone in the upper bits and quantized ra in the lower ones
+    Py_ssize_t m = 0;
+    for (Py_ssize_t i=0; i<n; i++) {
+        double *u = unit + 3*m;
+        if (!normalize(cart + 3*i, u))
+            continue;
+        double q = (lon_from_cartesian(u) + M_PI) / (2 * M_PI) * (double) ((uint64_t) 1 << RA_BITS);
+        uint64_t ra_key = (uint64_t) fmin(fmax(q, 0.), (double) (((uint64_t) 1 << RA_BITS) - 1));
+        uint64_t zone = (uint64_t) zone_of(z, asin(fmax(-1., fmin(1., u[2]))));
+        keys[m] = (zone << RA_BITS) | ra_key;
+        order[m] = m;
+        src[m] = i;
+        m++;
+    }
+    if (radix_sort(keys, order, m, threads) != 0)
+        goto done;
+
+    z->n = m;
+    for (Py_ssize_t p=0; p<m; p++) {
+        Py_ssize_t j = order[p];
+        memcpy(z->cart + 3*p, unit + 3*j, 3 * sizeof(double));
+        z->ra[p] = lon_from_cartesian(unit + 3*j);
+        z->idx[p] = src[j];
+        z->zone_start[(keys[p] >> RA_BITS) + 1]++;
+    }
+    for (int k=0; k<z->n_zones; k++)
+        z->zone_start[k + 1] += z->zone_start[k];
+    res = 0;
+
+done:
+    free(unit);
+    free(src);
+    free(keys);
+    free(order);
+    if (res != 0)
+        zone_index_free(z);
+    return res;
+}
+
+void zone_index_free(zone_index *z) {
+    free(z->cart);
+    free(z->ra);
+    free(z->idx);
+    free(z->zone_start);
+    z->cart = NULL;
+    z->ra = NULL;
+    z->idx = NULL;
+    z->zone_start = NULL;
+    z->n = 0;
+}
+
+int match_list_append(match_list *l, Py_ssize_t a, Py_ssize_t b, double sep) {
+    if (l->len == l->cap) {
+        Py_ssize_t cap = l->cap > 0 ? 2 * l->cap : 256;
+        Py_ssize_t *la = realloc(l->a, cap * sizeof(Py_ssize_t));
+        if (la == NULL)
+            return -1;
+        l->a = la;
+        Py_ssize_t *lb = realloc(l->b, cap * sizeof(Py_ssize_t));
+        if (lb == NULL)
+            return -1;
+        l->b = lb;
+        double *ls = realloc(l->sep, cap * sizeof(double));
+        if (ls == NULL)
+            return -1;
+        l->sep = ls;
+        l->cap = cap;
+    }
+    l->a[l->len] = a;
+    l->b[l->len] = b;
+    l->sep[l->len] = sep;
+    l->len++;
+    return 0;
+}
+
+void match_list_free(match_list *l) {
+    free(l->a);
+    free(l->b);
+    free(l->sep);
+    memset(l, 0, sizeof(match_list));
+}
+
+// First position in [lo, hi) with ra >= value
+static Py_ssize_t lower_bound(double ra[], Py_ssize_t lo, Py_ssize_t hi, double value) {
+    while (lo < hi) {
+        Py_ssize_t mid = lo + (hi - lo) / 2;
+        if (ra[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    Py_ssize_t best;
+    double best_chord2;
+} nearest_state;
+
+// Checks candidates at sorted positions [lo, hi), chord length is exact for small separations, unlike dot product
+static int scan(zone_index *z, double p[], Py_ssize_t ia, Py_ssize_t lo, Py_ssize_t hi,
+                nearest_state *nearest, match_list *out) {
+    for (Py_ssize_t k=lo; k<hi; k++) {
+        double *q = z->cart + 3*k;
+        double dx = p[0] - q[0];
+        double dy = p[1] - q[1];
+        double dz = p[2] - q[2];
+        double chord2 = dx*dx + dy*dy + dz*dz;
+        if (chord2 > z->chord2)
+            continue;
+        if (nearest != NULL) {
+            if (chord2 < nearest->best_chord2 || (chord2 == nearest->best_chord2 && z->idx[k] < z->idx[nearest->best])) {
+                nearest->best = k;
+                nearest->best_chord2 = chord2;
+            }
+        } else if (match_list_append(out, ia, z->idx[k], 2. * asin(fmin(1., sqrt(chord2) / 2))) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int zone_match(zone_index *z, double v[], Py_ssize_t ia, bool nearest, match_list *out) {
+    double p[3];
+    if (z->n == 0 || !normalize(v, p))
+        return 0;
+    double dec = asin(fmax(-1., fmin(1., p[2])));
+    double ra = lon_from_cartesian(p);
+    double r = z->radius;
+
+    // Half width of the ra window, whole circle when the search cap reaches a pole
+    double alpha = 2 * M_PI;
+    if (fabs(dec) + r < M_PI / 2 - PAD)
+        alpha = atan(sin(r) / sqrt(fabs(cos(dec - r) * cos(dec + r)))) + PAD;
+
+    nearest_state best = {-1, INFINITY};
+    nearest_state *best_ptr = nearest ? &best : NULL;
+    int zone_lo = zone_of(z, dec - r - PAD);
+    int zone_hi = zone_of(z, dec + r + PAD);
+    for (int zone=zone_lo; zone<=zone_hi; zone++) {
+        Py_ssize_t start = z->zone_start[zone];
+        Py_ssize_t end = z->zone_start[zone + 1];
+        if (start == end)
+            continue;
+        int res;
+        if (alpha >= M_PI) {
+            res = scan(z, p, ia, start, end, best_ptr, out);
+        } else {
+            // ra window split in two, if it wraps around +-pi
+            double lo = ra - alpha;
+            double hi = ra + alpha;
+            double lo2 = lo, hi2 = hi;
+            if (lo < -M_PI) {
+                lo2 = lo + 2 * M_PI;
+                hi2 = M_PI;
+                lo = -M_PI;
+            } else if (hi > M_PI) {
+                lo2 = -M_PI;
+                hi2 = hi - 2 * M_PI;
+                hi = M_PI;
+            }
+            Py_ssize_t from = lower_bound(z->ra, start, end, lo);
+            Py_ssize_t to = lower_bound(z->ra, from, end, nextafter(hi, INFINITY));
+            res = scan(z, p, ia, from, to, best_ptr, out);
+            if (res == 0 && (lo2 != lo || hi2 != hi)) {
+                from = lower_bound(z->ra, start, end, lo2);
+                to = lower_bound(z->ra, from, end, nextafter(hi2, INFINITY));
+                res = scan(z, p, ia, from, to, best_ptr, out);
+            }
+        }
+        if (res != 0)
+            return -1;
+    }
+    if (nearest && best.best >= 0)
+        return match_list_append(out, ia, z->idx[best.best], 2. * asin(fmin(1., sqrt(best.best_chord2) / 2)));
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef ZONES_H
+#define ZONES_H
+#include "utils.h"
+
+// Directions split in declination (lat) zones of height >= radius, sorted by right ascension (lon) inside a zone,
+// Gray et al. "The Zones Algorithm for Finding Points-Near-a-Point or Cross-Matching Spatial Datasets" (2006)
+typedef struct {
+    double radius;
+    double chord2;
+    double height;
+    int n_zones;
+    Py_ssize_t n;
+    double *cart;
+    double *ra;
+    Py_ssize_t *idx;
+    Py_ssize_t *zone_start;
+} zone_index;
+
+// Growable match pairs output
+typedef struct {
+    Py_ssize_t *a;
+    Py_ssize_t *b;
+    double *sep;
+    Py_ssize_t len;
+    Py_ssize_t cap;
+} match_list;
+
+// Returns -1 if out of memory. Zero vectors are left out of the index.
+int zone_index_build(zone_index *, double cart[], Py_ssize_t n, double radius, int threads);
+void zone_index_free(zone_index *);
+
+// Appends matches of direction p (any non-zero length) to out, either the nearest one or all within radius.
+// Returns -1 if out of memory.
+int zone_match(zone_index *, double p[], Py_ssize_t ia, bool nearest, match_list *out);
+int match_list_append(match_list *, Py_ssize_t a, Py_ssize_t b, double sep);
+void match_list_free(match_list *);
+
+#endif
@@ -1,9 +1,11 @@
 import unittest
 import numpy as np
 import pickle
+import threading
+from array import array
 from astropy.coordinates import cartesian_to_spherical, spherical_to_cartesian
 
-from vector import Vector
+from vector import Vector, Random, sfc_keys, sfc_sort, crossmatch
 
 
 class MIterable:
@@ -298,6 +300,107 @@ class Test(unittest.TestCase):
         self.assertEqual(Vector([1, 2, 3]).__str__(), '[1.000000, 2.000000, 3.000000>')
 
 
+class InPlace(unittest.TestCase):
+    def test_iadd(self):
+        v = Vector([1, 2, 3])
+        same = v
+        v += Vector([3, 3, 3])
+        self.assertIs(same, v)
+        self.assertEqual((4, 5, 6), v.cart)
+        r, lat, lon = cartesian_to_spherical(4, 5, 6)
+        self.assertAlmostEqual(r.value, v.r)
+        self.assertAlmostEqual(lat.value, v.lat)
+
+        def f():
+            nonlocal v
+            v += 1
+        self.assertRaisesRegex(
+            TypeError,
+            r"unsupported operand type\(s\) for \+=: 'vector\.Vector' and 'int'",
+            f,
+        )
+
+    def test_isub(self):
+        v = Vector([1, 2, 3])
+        same = v
+        v -= Vector([3, 2, 1])
+        self.assertIs(same, v)
+        self.assertEqual((-2, 0, 2), v.cart)
+
+    def test_imul(self):
+        v = Vector([1, 2, 3])
+        same = v
+        r, lat, lon = v.sph
+        v *= 2
+        self.assertIs(same, v)
+        self.assertEqual((2, 4, 6), v.cart)
+        self.assertEqual((2 * r, lat, lon), v.sph)
+        v *= -0.5
+        self.assertEqual((-1, -2, -3), v.cart)
+        r, lat, lon = cartesian_to_spherical(-1, -2, -3)
+        for a, b in zip((r.value, lat.value, lon.value - 2 * np.pi), v.sph):
+            self.assertAlmostEqual(a, b)
+        for axis in ([1, 0, 0], [0, 1, 0], [0, 0, 1], [-1, 0, 0]):
+            a = Vector(axis)
+            a.sph
+            a *= -2
+            self.assertEqual(Vector(a.cart).sph, a.sph)
+        v *= Vector([4, -6, 1])
+        self.assertEqual(tuple(np.cross([-1, -2, -3], [4, -6, 1])), v.cart)
+        self.assertEqual(Vector(v.cart).sph, v.sph)
+
+    def test_iadd_scaled(self):
+        v = Vector([1, 2, 3])
+        self.assertIs(v, v.iadd_scaled(Vector([1, 0, -1]), 2))
+        self.assertEqual((3, 2, 1), v.cart)
+        self.assertEqual(Vector([3, 2, 1]).sph, v.sph)
+        self.assertRaisesRegex(
+            TypeError,
+            'Vector.iadd_scaled factor must be numeric, got "str"',
+            lambda: v.iadd_scaled(v, 'a'),
+        )
+        self.assertRaisesRegex(
+            TypeError,
+            'Vector.iadd_scaled takes 2 arguments, got 1',
+            lambda: v.iadd_scaled(v),
+        )
+
+    def test_normalize_(self):
+        v = Vector([3, 0, 4])
+        lat, lon = v.lat, v.lon
+        self.assertIs(v, v.normalize_())
+        self.assertEqual((0.6, 0, 0.8), v.cart)
+        self.assertEqual((1, lat, lon), v.sph)
+        self.assertRaisesRegex(
+            ValueError,
+            'Vector.normalize_ zero length Vector',
+            lambda: Vector([0, 0, 0]).normalize_(),
+        )
+
+    def test_set_cart_xyz(self):
+        v = Vector([1, 2, 3])
+        v.sph
+        self.assertIs(v, v.set_cart_xyz(4, 5.5, 6))
+        self.assertEqual((4, 5.5, 6), v.cart)
+        self.assertEqual(Vector([4, 5.5, 6]).sph, v.sph)
+        self.assertRaisesRegex(
+            TypeError,
+            'Vector.set_cart_xyz arguments must be numeric, got "str" at 2',
+            lambda: v.set_cart_xyz(1, 2, 'a'),
+        )
+
+    def test_integration_loop(self):
+        pos = Vector([0, 0, 0])
+        vel = Vector([1, 2, 3])
+        acc = Vector([0, 0, -1])
+        ids = id(pos), id(vel)
+        for _ in range(100):
+            vel.iadd_scaled(acc, 0.01)
+            pos += vel * 0.01
+        self.assertEqual(ids, (id(pos), id(vel)))
+        self.assertAlmostEqual(1 + 2 + 3 - 0.01 * 101 / 2, sum(pos.cart))
+
+
 class Components(unittest.TestCase):
     def test_x(self):
         v = Vector([1, 2, 3])
@@ -454,3 +557,275 @@ class Math(unittest.TestCase):
     def test_abs(self):
         v = Vector([1, 2, 3])
         self.assertEqual(abs(v), (1 + 4 + 9) ** 0.5)
+
+
+class RandomVectors(unittest.TestCase):
+    def test_seed_reproducible(self):
+        a = Random(42).sphere(100)
+        b = Random(42).sphere(100)
+        self.assertEqual([v.cart for v in a], [v.cart for v in b])
+        c = Random(43).sphere(100)
+        self.assertNotEqual([v.cart for v in a], [v.cart for v in c])
+
+    def test_split_streams(self):
+        parent = Random(1)
+        child = parent.split()
+        self.assertEqual(
+            [v.cart for v in child.gauss(10)],
+            [v.cart for v in Random(1).gauss(10)],
+        )
+        self.assertNotEqual(
+            [v.cart for v in parent.gauss(10)],
+            [v.cart for v in Random(1).gauss(10)],
+        )
+
+    def test_streams(self):
+        self.assertEqual(
+            [v.cart for v in Random(1, stream=10 ** 9).gauss(10)],
+            [v.cart for v in Random(1, stream=10 ** 9).gauss(10)],
+        )
+        self.assertNotEqual(
+            [v.cart for v in Random(1, stream=1).gauss(10)],
+            [v.cart for v in Random(1).gauss(10)],
+        )
+        self.assertNotEqual(
+            [v.cart for v in Random(1, stream=1).gauss(10)],
+            [v.cart for v in Random(1, stream=2).gauss(10)],
+        )
+
+    def test_sphere(self):
+        vs = Random(0).sphere(10000)
+        for v in vs:
+            self.assertAlmostEqual(1, v.r, 12)
+        mean = np.mean([v.cart for v in vs], axis=0)
+        self.assertTrue(np.all(np.abs(mean) < 0.05))
+
+    def test_ball(self):
+        rs = np.array([v.r for v in Random(0).ball(10000)])
+        self.assertTrue(np.all(rs <= 1))
+        # P(r < 0.5) = 1/8 for uniform ball
+        self.assertAlmostEqual(0.125, np.mean(rs < 0.5), 1)
+
+    def test_gauss(self):
+        carts = np.array([v.cart for v in Random(0).gauss(10000, sigma=2)])
+        self.assertTrue(np.all(np.abs(carts.std(axis=0) - 2) < 0.1))
+
+    def test_cone(self):
+        axis = Vector([1, 1, 0])
+        angle = 0.1
+        for v in Random(0).cone(axis, angle, 1000):
+            self.assertAlmostEqual(1, v.r, 12)
+            self.assertLessEqual(np.arccos(v.dot(axis) / axis.r), angle + 1e-9)
+        self.assertRaisesRegex(
+            ValueError,
+            'Random.cone axis must be a non-zero vector',
+            lambda: Random(0).cone([0, 0, 0], angle, 1),
+        )
+
+    def test_too_many(self):
+        self.assertRaises(MemoryError, lambda: Random(0).sphere(2 ** 62))
+
+    def test_shared_between_threads(self):
+        rnd = Random(0)
+        buf = np.empty((3000000, 3))
+        t = threading.Thread(target=lambda: rnd.sphere(out=buf))
+        t.start()
+        # Generation releases the GIL, the generator is busy until it finishes
+        raised = False
+        while t.is_alive() and not raised:
+            try:
+                rnd.uniform()
+            except RuntimeError as e:
+                self.assertRegex(str(e), 'Random is already generating in another thread')
+                raised = True
+        t.join()
+        self.assertTrue(raised)
+        np.testing.assert_allclose(1, np.linalg.norm(buf, axis=1))
+
+    def test_out_buffer(self):
+        buf = array('d', bytes(8 * 3 * 50))
+        self.assertIs(buf, Random(7).sphere(out=buf))
+        self.assertEqual(
+            [v.cart for v in Random(7).sphere(50)],
+            [tuple(buf[i:i + 3]) for i in range(0, len(buf), 3)],
+        )
+        arr = np.zeros((50, 3))
+        Random(7).sphere(out=arr)
+        self.assertEqual(list(buf), list(arr.ravel()))
+        self.assertRaisesRegex(
+            ValueError,
+            'Random.ball output must contain a multiple of 3 elements, got 4',
+            lambda: Random(0).ball(out=array('d', [0] * 4)),
+        )
+        self.assertRaisesRegex(
+            TypeError,
+            'Random.ball output must be a contiguous writable buffer of doubles, got "list"',
+            lambda: Random(0).ball(out=[0] * 3),
+        )
+
+
+class SpaceFillingCurve(unittest.TestCase):
+    def test_morton_keys(self):
+        # Unit cube corners quantize to 0 and 2^21 - 1, morton interleaves x, y, z bits
+        vs = [Vector([0, 0, 0]), Vector([1, 0, 0]), Vector([0, 0, 1]), Vector([1, 1, 1])]
+        self.assertEqual(
+            [0, 0x4924924924924924, 0x1249249249249249, 2 ** 63 - 1],
+            sfc_keys(vs, 'morton'),
+        )
+
+    def test_non_finite(self):
+        # Cube is [1, 3] on every axis, infinite coordinate goes to its face
+        inf = float('inf')
+        vs = [Vector([inf, 1, 1]), Vector([1, 1, 1]), Vector([3, 3, 3]), Vector([-inf, 3, 3])]
+        self.assertEqual(
+            [0x4924924924924924, 0, 2 ** 63 - 1, 0x36db6db6db6db6db],
+            sfc_keys(vs, 'morton'),
+        )
+        order = sfc_sort(vs, 'morton')
+        self.assertEqual([1, 3, 0, 2], order)
+
+    def test_hilbert_adjacent(self):
+        pts = [Vector([x, y, z]) for x in range(8) for y in range(8) for z in range(8)]
+        order = sfc_sort(pts, 'hilbert')
+        self.assertEqual(sorted(order), list(range(len(pts))))
+        for a, b in zip(pts, pts[1:]):
+            self.assertEqual(1, sum(abs(x - y) for x, y in zip(a.cart, b.cart)))
+
+    def test_sort_list(self):
+        vs = Random(0).sphere(1000)
+        keys = sfc_keys(vs, 'morton', 'sph')
+        sorted_vs = list(vs)
+        order = sfc_sort(sorted_vs, 'morton', 'sph')
+        self.assertEqual(sorted(keys), [keys[i] for i in order])
+        for i, v in enumerate(sorted_vs):
+            self.assertIs(vs[order[i]], v)
+
+    def test_sort_buffer_parallel(self):
+        pts = np.empty((200000, 3))
+        Random(1).ball(out=pts)
+        keys = np.array(sfc_keys(pts), dtype=np.uint64)
+        sorted_pts = pts.copy()
+        order = sfc_sort(sorted_pts, threads=4)
+        self.assertTrue(np.array_equal(pts[order], sorted_pts))
+        k = keys[order]
+        self.assertTrue(np.all(k[1:] >= k[:-1]))
+        self.assertEqual(order, sfc_sort(pts.copy(), threads=1))
+
+    def test_wrong_args(self):
+        self.assertRaisesRegex(
+            ValueError,
+            'curve must be "morton" or "hilbert", got "peano"',
+            lambda: sfc_keys([], 'peano'),
+        )
+        self.assertRaisesRegex(
+            TypeError,
+            'sfc_keys vectors must contain Vectors, got "int" at 1',
+            lambda: sfc_keys([Vector([1, 2, 3]), 1]),
+        )
+        self.assertRaisesRegex(
+            TypeError,
+            'sfc_sort vectors must be a list of Vectors or a writable buffer of doubles, got "tuple"',
+            lambda: sfc_sort((Vector([1, 2, 3]),)),
+        )
+        for threads in (-1, 2 ** 31):
+            self.assertRaisesRegex(
+                ValueError,
+                r'sfc_keys threads must be within \[0, 2147483647\], got %d' % threads,
+                lambda: sfc_keys([], threads=threads),
+            )
+
+    def test_many_threads(self):
+        pts = np.empty((300000, 3))
+        Random(2).sphere(out=pts)
+        self.assertEqual(sfc_keys(pts, threads=1), sfc_keys(pts, threads=100000))
+
+
+class CrossMatch(unittest.TestCase):
+    @staticmethod
+    def brute_force(a, b, radius):
+        a = a / np.linalg.norm(a, axis=1)[:, None]
+        b = b / np.linalg.norm(b, axis=1)[:, None]
+        sep = np.arccos(np.clip(a @ b.T, -1, 1))
+        return sep, set(zip(*[x.tolist() for x in np.nonzero(sep <= radius)]))
+
+    @staticmethod
+    def collect(chunks):
+        return [p for a, b, sep in chunks for p in zip(a, b, sep)]
+
+    def test_all(self):
+        for radius in (0.01, 0.2, 1.5, 3):
+            a = np.empty((300, 3))
+            b = np.empty((400, 3))
+            Random(1).sphere(out=a)
+            Random(2).ball(out=b)
+            sep, expected = self.brute_force(a, b, radius)
+            pairs = self.collect(crossmatch(a, b, radius, 'all', chunk_size=17, threads=3))
+            self.assertEqual(expected, {(i, j) for i, j, _ in pairs})
+            self.assertEqual(len(expected), len(pairs))
+            self.assertEqual(sorted(i for i, _, _ in pairs), [i for i, _, _ in pairs])
+            for i, j, s in pairs:
+                self.assertAlmostEqual(sep[i, j], s, 7)
+
+    def test_nearest(self):
+        a = Random(3).sphere(500)
+        b = Random(4).cone(Vector([0, 0, 1]), 1, 2000)
+        radius = 0.05
+        sep, expected = self.brute_force(np.array([v.cart for v in a]), np.array([v.cart for v in b]), radius)
+        pairs = self.collect(crossmatch(a, b, radius))
+        self.assertEqual({i for i, _ in expected}, {i for i, _, _ in pairs})
+        for i, j, s in pairs:
+            self.assertEqual(np.argmin(sep[i]), j)
+
+    def test_self_match(self):
+        vs = Random(5).sphere(1000)
+        pairs = self.collect(crossmatch(vs, vs, 0))
+        self.assertEqual([(i, i, 0) for i in range(1000)], pairs)
+
+    def test_wrong_args(self):
+        self.assertRaisesRegex(
+            ValueError,
+            'crossmatch mode must be "nearest" or "all", got "any"',
+            lambda: crossmatch([], [], 1, 'any'),
+        )
+        self.assertRaisesRegex(
+            ValueError,
+            r'crossmatch radius must be within \[0, pi\]',
+            lambda: crossmatch([], [], -1),
+        )
+        self.assertRaisesRegex(
+            TypeError,
+            'crossmatch b must contain Vectors, got "str" at 0',
+            lambda: crossmatch([], ['a'], 1),
+        )
+        for threads in (-1, 2 ** 31):
+            self.assertRaisesRegex(
+                ValueError,
+                r'crossmatch threads must be within \[0, 2147483647\], got %d' % threads,
+                lambda: crossmatch([], [], 1, threads=threads),
+            )
+
+    def test_many_threads(self):
+        a = np.empty((5000, 3))
+        Random(6).sphere(out=a)
+        self.assertEqual(
+            self.collect(crossmatch(a, a, 0.05, 'all', threads=1)),
+            self.collect(crossmatch(a, a, 0.05, 'all', threads=100000)),
+        )
+        v = [Vector([1, 0, 0])]
+        self.assertEqual(
+            [(0, 0, 0)],
+            self.collect(crossmatch(v, v, 0.1, chunk_size=2 ** 62, threads=2 ** 31 - 1)),
+        )
+
+    def test_buffer_released(self):
+        a = array('d', [1, 0, 0, 0, 1, 0])
+        chunks = crossmatch(a, [Vector([1, 0, 0])], 0.1, chunk_size=1)
+        next(chunks)
+        self.assertRaises(BufferError, lambda: a.append(1))
+        self.assertEqual([], list(chunks))
+        a.extend([0, 0])
+        self.assertEqual(8, len(a))
+        a = array('d', [1, 0, 0])
+        list(crossmatch(a, [], 0.1))
+        a.append(1)
+        self.assertEqual(4, len(a))